@@ -31,12 +31,20 @@
 #include "PmLogCtl.h"
 #include "PmLogLib.h"
 
+#include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/klog.h>
+#include <sys/inotify.h>
 #include <sys/syslog.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 
 bool flag_silence = false;
 
@@ -221,10 +229,11 @@ static int SortCmpContextInfoByName(const void *p1, const void *p2)
 
 
 /**
- * @brief PrvGetContextList
+ * @brief PrvListContexts
+ *
+ * List all the contexts, sorted by name.
  */
-static PmLogErr PrvGetContextList(ContextsInfo_t *contextInfosP,
-                                  const char *matchContextName)
+static PmLogErr PrvListContexts(ContextsInfo_t *contextInfosP)
 {
 	PmLogErr        logErr;
 	int             n;
@@ -269,11 +278,6 @@ static PmLogErr PrvGetContextList(ContextsInfo_t *contextInfosP,
 			return logErr;
 		}
 
-		if (!PrvMatchContextName(contextInfoP->contextName, matchContextName))
-		{
-			continue;
-		}
-
 		if (contextInfosP->numContexts >= (PMLOG_MAX_NUM_CONTEXTS + 1))
 		{
 			return kPmLogErr_Unknown;
@@ -292,6 +296,92 @@ static PmLogErr PrvGetContextList(ContextsInfo_t *contextInfosP,
 }
 
 
+/*
+ * All the contexts, sorted by name, as last listed.  Contexts are never
+ * removed, so the list only needs refreshing when there are more of
+ * them, which matters when many commands are run by the shell.
+ */
+static ContextsInfo_t *gAllContextInfos = NULL;
+
+
+/**
+ * @brief PrvGetAllContexts
+ */
+static PmLogErr PrvGetAllContexts(const ContextsInfo_t **contextInfosPP)
+{
+	PmLogErr        logErr;
+	int             n;
+
+	n = 0;
+	logErr = PmLogGetNumContexts(&n);
+
+	if (logErr != kPmLogErr_None)
+	{
+		return logErr;
+	}
+
+	if ((gAllContextInfos == NULL) || (gAllContextInfos->numContexts != n))
+	{
+		if (gAllContextInfos == NULL)
+		{
+			gAllContextInfos = (ContextsInfo_t *) malloc(sizeof(*gAllContextInfos));
+
+			if (gAllContextInfos == NULL)
+			{
+				return kPmLogErr_Unknown;
+			}
+		}
+
+		logErr = PrvListContexts(gAllContextInfos);
+
+		if (logErr != kPmLogErr_None)
+		{
+			free(gAllContextInfos);
+			gAllContextInfos = NULL;
+			return logErr;
+		}
+	}
+
+	*contextInfosPP = gAllContextInfos;
+	return kPmLogErr_None;
+}
+
+
+/**
+ * @brief PrvGetContextList
+ *
+ * Get the contexts that match, sorted by name.
+ */
+static PmLogErr PrvGetContextList(ContextsInfo_t *contextInfosP,
+                                  const char *matchContextName)
+{
+	const ContextsInfo_t   *allContextInfosP;
+	PmLogErr                logErr;
+	int                     i;
+
+	contextInfosP->numContexts = 0;
+
+	logErr = PrvGetAllContexts(&allContextInfosP);
+
+	if (logErr != kPmLogErr_None)
+	{
+		return logErr;
+	}
+
+	for (i = 0; i < allContextInfosP->numContexts; i++)
+	{
+		if (PrvMatchContextName(allContextInfosP->contextInfos[ i ].contextName,
+		                        matchContextName))
+		{
+			contextInfosP->contextInfos[ contextInfosP->numContexts++ ] =
+			    allContextInfosP->contextInfos[ i ];
+		}
+	}
+
+	return kPmLogErr_None;
+}
+
+
 /**
  * @brief PrvResolveContextNameAlias
  *
@@ -311,105 +401,1394 @@ static const char *PrvResolveContextNameAlias(const char *contextName)
 
 
 /**
- * @brief ShowContext
+ * @brief PrvHashContextName
+ */
+static unsigned int PrvHashContextName(const char *s)
+{
+	unsigned int    h;
+
+	h = 2166136261u;
+
+	while (*s != 0)
+	{
+		h = (h ^ (unsigned char) *s++) * 16777619u;
+	}
+
+	return h;
+}
+
+
+/**
+ * ContextNameIndex_t
+ *
+ * Hash from context name to its index in a ContextsInfo_t, open
+ * addressed; numSlots is a power of 2 and empty slots are -1.
+ */
+typedef struct
+{
+	int             numSlots;
+	int            *slots;
+}
+ContextNameIndex_t;
+
+
+/**
+ * @brief PrvBuildContextNameIndex
+ * @return false if out of memory.
+ */
+static bool PrvBuildContextNameIndex(const ContextsInfo_t *contextInfosP,
+                                     ContextNameIndex_t *indexP)
+{
+	int             i;
+	unsigned int    slot;
+
+	indexP->numSlots = 2;
+
+	while (indexP->numSlots < 2 * contextInfosP->numContexts)
+	{
+		indexP->numSlots *= 2;
+	}
+
+	indexP->slots = (int *) malloc(indexP->numSlots * sizeof(int));
+
+	if (indexP->slots == NULL)
+	{
+		return false;
+	}
+
+	for (i = 0; i < indexP->numSlots; i++)
+	{
+		indexP->slots[ i ] = -1;
+	}
+
+	for (i = 0; i < contextInfosP->numContexts; i++)
+	{
+		slot = PrvHashContextName(contextInfosP->contextInfos[ i ].contextName) &
+		       (indexP->numSlots - 1);
+
+		while (indexP->slots[ slot ] >= 0)
+		{
+			slot = (slot + 1) & (indexP->numSlots - 1);
+		}
+
+		indexP->slots[ slot ] = i;
+	}
+
+	return true;
+}
+
+
+/**
+ * @brief PrvFindContextInfo
+ * @return the context with exactly the given name, or NULL.
+ */
+static const ContextInfo_t *PrvFindContextInfo(
+    const ContextsInfo_t *contextInfosP, const ContextNameIndex_t *indexP,
+    const char *contextName)
+{
+	const ContextInfo_t    *contextInfoP;
+	unsigned int            slot;
+
+	slot = PrvHashContextName(contextName) & (indexP->numSlots - 1);
+
+	while (indexP->slots[ slot ] >= 0)
+	{
+		contextInfoP = &contextInfosP->contextInfos[ indexP->slots[ slot ] ];
+
+		if (strcmp(contextInfoP->contextName, contextName) == 0)
+		{
+			return contextInfoP;
+		}
+
+		slot = (slot + 1) & (indexP->numSlots - 1);
+	}
+
+	return NULL;
+}
+
+
+/**
+ * @brief PrvLevelToString
  *
- * Display information about the given logging context, i.e. name
- * and active level.
+ * PmLogLevelToString, looked up once per level rather than once per
+ * context.
+ */
+static const char *PrvLevelToString(int level)
+{
+	static const char  *levelStrs[ kPmLogLevel_Debug - kPmLogLevel_None + 1 ];
+	const char         *levelStr;
+	int                 i;
+
+	if ((level < kPmLogLevel_None) || (level > kPmLogLevel_Debug))
+	{
+		levelStr = PmLogLevelToString(level);
+		return (levelStr != NULL) ? levelStr : "Unknown";
+	}
+
+	i = level - kPmLogLevel_None;
+
+	if (levelStrs[ i ] == NULL)
+	{
+		levelStr = PmLogLevelToString(level);
+		levelStrs[ i ] = (levelStr != NULL) ? levelStr : "Unknown";
+	}
+
+	return levelStrs[ i ];
+}
+
+
+typedef enum
+{
+	SHOW_FORMAT_TEXT,
+	SHOW_FORMAT_JSON,
+	SHOW_FORMAT_TSV
+}
+ShowFormat_t;
+
+
+/*
+ * wasLevels[] value for a context that is not in the --diff snapshot.
+ */
+#define SHOW_LEVEL_ABSENT   (kPmLogLevel_None - 1)
+
+
+/**
+ * ShowBuf_t
  *
- * If matchContextName is specified, only display information if the
- * given context has the same name.
+ * The machine readable output, built up so it is written at once.
+ * The buffer is sized for the worst case before anything is added.
+ */
+typedef struct
+{
+	char           *buf;
+	size_t          len;
+}
+ShowBuf_t;
+
+
+/**
+ * @brief PrvShowBufAdd
+ */
+static void PrvShowBufAdd(ShowBuf_t *bufP, const char *s)
+{
+	size_t  n;
+
+	n = strlen(s);
+	memcpy(bufP->buf + bufP->len, s, n);
+	bufP->len += n;
+}
+
+
+/**
+ * @brief PrvShowBufAddJsonStr
  *
- * @return 1 if matched else 0.
+ * Add s as a quoted JSON string; at most 6 chars per char of s.
  */
-static void ShowContext(const ContextInfo_t *contextInfoP)
+static void PrvShowBufAddJsonStr(ShowBuf_t *bufP, const char *s)
 {
-	const char *levelStr;
+	unsigned char   c;
 
-	levelStr = PmLogLevelToString(contextInfoP->context->enabledLevel);
+	bufP->buf[ bufP->len++ ] = '"';
 
-	if (levelStr == NULL)
+	while ((c = (unsigned char) *s++) != 0)
 	{
-		levelStr = "Unknown";
+		if ((c == '"') || (c == '\\'))
+		{
+			bufP->buf[ bufP->len++ ] = '\\';
+			bufP->buf[ bufP->len++ ] = (char) c;
+		}
+		else if (c < 0x20)
+		{
+			bufP->len += sprintf(bufP->buf + bufP->len, "\\u%04x", c);
+		}
+		else
+		{
+			bufP->buf[ bufP->len++ ] = (char) c;
+		}
 	}
 
-	ErrPrint("Context '%s' = %s\n", contextInfoP->contextName, levelStr);
+	bufP->buf[ bufP->len++ ] = '"';
 }
 
 
 /**
- * @brief DoCmdShow
+ * @brief PrvReadShowSnapshot
  *
- * Usage: show [<context>]             # show logging context(s)
+ * Read a snapshot as written by "show --tsv", i.e. lines of
+ * "<context>\t<level>", and set wasLevels[ i ] to the level that the
+ * i'th of contextInfosP had then.  Contexts not in contextInfosP are
+ * ignored, as are blank lines and lines starting with '#'.
  *
- * By default, show information about all registered logging contexts,
- * else show information for the specified context.
+ * @return RESULT_OK, or an error which has been reported.
+ */
+static Result PrvReadShowSnapshot(const char *path,
+                                  const ContextsInfo_t *contextInfosP, int *wasLevels)
+{
+	ContextNameIndex_t      index;
+	const ContextInfo_t    *contextInfoP;
+	const int              *levelIntP;
+	FILE                   *f;
+	char                   *line;
+	size_t                  lineSize;
+	ssize_t                 n;
+	int                     lineNum;
+	char                   *sep;
+	Result                  result;
+	int                     err;
+
+	f = fopen(path, "r");
+
+	if (f == NULL)
+	{
+		err = errno;
+		ErrPrint("Error opening '%s': %s\n", path, strerror(err));
+		return RESULT_PARAM_ERR;
+	}
+
+	if (!PrvBuildContextNameIndex(contextInfosP, &index))
+	{
+		ErrPrint("Out of memory.\n");
+		(void) fclose(f);
+		return RESULT_RUN_ERR;
+	}
+
+	result = RESULT_OK;
+	line = NULL;
+	lineSize = 0;
+	lineNum = 0;
+
+	while ((n = getline(&line, &lineSize, f)) >= 0)
+	{
+		lineNum++;
+
+		while ((n > 0) && ((line[ n - 1 ] == '\n') || (line[ n - 1 ] == '\r')))
+		{
+			line[ --n ] = 0;
+		}
+
+		if ((n == 0) || (line[ 0 ] == '#'))
+		{
+			continue;
+		}
+
+		sep = strchr(line, '\t');
+		levelIntP = NULL;
+
+		if (sep != NULL)
+		{
+			*sep = 0;
+			levelIntP = PmLogStringToLevel(sep + 1);
+		}
+
+		if (levelIntP == NULL)
+		{
+			ErrPrint("%s:%d: Invalid snapshot line.\n", path, lineNum);
+			result = RESULT_PARAM_ERR;
+			break;
+		}
+
+		contextInfoP = PrvFindContextInfo(contextInfosP, &index, line);
+
+		if (contextInfoP != NULL)
+		{
+			wasLevels[ contextInfoP - contextInfosP->contextInfos ] = *levelIntP;
+		}
+	}
+
+	free(line);
+	free(index.slots);
+	(void) fclose(f);
+
+	return result;
+}
+
+
+/**
+ * @brief PrvShowContexts
+ *
+ * Show the given contexts, i.e. name and active level.  With
+ * wasLevels only show those whose level is not the same as then,
+ * along with the level then.
+ *
+ * Text goes to stderr as it always has.  JSON and TSV go to stdout
+ * with a single write, so a consumer never sees part of a list.
+ *
+ * @return RESULT_OK, or an error which has been reported.
+ */
+static Result PrvShowContexts(const ContextsInfo_t *contextInfosP,
+                              ShowFormat_t format, const int *wasLevels)
+{
+	const ContextInfo_t    *contextInfoP;
+	ShowBuf_t               out;
+	const char             *levelStr;
+	const char             *wasStr;
+	int                     level;
+	int                     i;
+	bool                    first;
+
+	out.buf = NULL;
+	out.len = 0;
+
+	if (format != SHOW_FORMAT_TEXT)
+	{
+		/* the longest level names are "emerg"/"warning"; 32 is ample */
+		out.buf = (char *) malloc(16 + contextInfosP->numContexts *
+		                          (6 * PMLOG_MAX_CONTEXT_NAME_LEN + 2 * 32 + 64));
+
+		if (out.buf == NULL)
+		{
+			ErrPrint("Out of memory.\n");
+			return RESULT_RUN_ERR;
+		}
+	}
+
+	if (format == SHOW_FORMAT_JSON)
+	{
+		PrvShowBufAdd(&out, "[");
+	}
+
+	first = true;
+
+	for (i = 0; i < contextInfosP->numContexts; i++)
+	{
+		contextInfoP = &contextInfosP->contextInfos[ i ];
+		level = contextInfoP->context->enabledLevel;
+
+		if ((wasLevels != NULL) && (wasLevels[ i ] == level))
+		{
+			continue;
+		}
+
+		levelStr = PrvLevelToString(level);
+		wasStr = NULL;
+
+		if ((wasLevels != NULL) && (wasLevels[ i ] != SHOW_LEVEL_ABSENT))
+		{
+			wasStr = PrvLevelToString(wasLevels[ i ]);
+		}
+
+		switch (format)
+		{
+			case SHOW_FORMAT_TEXT:
+				if (wasLevels == NULL)
+				{
+					ErrPrint("Context '%s' = %s\n", contextInfoP->contextName,
+					         levelStr);
+				}
+				else
+				{
+					ErrPrint("Context '%s' = %s (was %s)\n",
+					         contextInfoP->contextName, levelStr,
+					         (wasStr != NULL) ? wasStr : "not present");
+				}
+
+				break;
+
+			case SHOW_FORMAT_JSON:
+				PrvShowBufAdd(&out, first ? "\n  {\"context\": " : ",\n  {\"context\": ");
+				PrvShowBufAddJsonStr(&out, contextInfoP->contextName);
+				PrvShowBufAdd(&out, ", \"level\": ");
+				PrvShowBufAddJsonStr(&out, levelStr);
+
+				if (wasLevels != NULL)
+				{
+					PrvShowBufAdd(&out, ", \"was\": ");
+
+					if (wasStr != NULL)
+					{
+						PrvShowBufAddJsonStr(&out, wasStr);
+					}
+					else
+					{
+						PrvShowBufAdd(&out, "null");
+					}
+				}
+
+				PrvShowBufAdd(&out, "}");
+				break;
+
+			case SHOW_FORMAT_TSV:
+				PrvShowBufAdd(&out, contextInfoP->contextName);
+				PrvShowBufAdd(&out, "\t");
+				PrvShowBufAdd(&out, levelStr);
+
+				if (wasLevels != NULL)
+				{
+					PrvShowBufAdd(&out, "\t");
+					PrvShowBufAdd(&out, (wasStr != NULL) ? wasStr : "-");
+				}
+
+				PrvShowBufAdd(&out, "\n");
+				break;
+		}
+
+		first = false;
+	}
+
+	if (format == SHOW_FORMAT_JSON)
+	{
+		PrvShowBufAdd(&out, first ? "]\n" : "\n]\n");
+	}
+
+	if (out.len > 0)
+	{
+		if ((fwrite(out.buf, 1, out.len, stdout) != out.len) ||
+		    (fflush(stdout) != 0))
+		{
+			ErrPrint("Error writing output: %s\n", strerror(errno));
+			free(out.buf);
+			return RESULT_RUN_ERR;
+		}
+	}
+
+	free(out.buf);
+	return RESULT_OK;
+}
+
+
+/**
+ * @brief DoCmdShow
+ *
+ * Usage: show [--json | --tsv] [--diff <snapshot>] [<context>]
+ *
+ * By default, show information about all registered logging contexts,
+ * else show information for the specified context.
+ *
+ * --json and --tsv write the list to stdout instead; the output of
+ * --tsv can be saved as the snapshot for a later --diff, which then
+ * only shows the contexts whose level has changed since.
+ */
+static Result DoCmdShow(int argc, char *argv[])
+{
+	const char     *matchContextName;
+	const char     *snapshotPath;
+	ShowFormat_t    format;
+	ContextsInfo_t     *contextInfos = NULL;
+	int            *wasLevels;
+	PmLogErr        logErr;
+	Result          result;
+	const char     *arg;
+	int             argIndex;
+	int             i;
+
+	matchContextName = NULL;
+	snapshotPath = NULL;
+	format = SHOW_FORMAT_TEXT;
+
+	argIndex = 1;
+
+	while (argIndex < argc)
+	{
+		arg = argv[ argIndex++ ];
+
+		if (strcmp(arg, "--json") == 0)
+		{
+			format = SHOW_FORMAT_JSON;
+		}
+		else if (strcmp(arg, "--tsv") == 0)
+		{
+			format = SHOW_FORMAT_TSV;
+		}
+		else if (strcmp(arg, "--diff") == 0)
+		{
+			if (argIndex >= argc)
+			{
+				ErrPrint("Invalid parameter: %s requires value\n", arg);
+				return RESULT_PARAM_ERR;
+			}
+
+			snapshotPath = argv[ argIndex++ ];
+		}
+		else if ((arg[ 0 ] == '-') && (arg[ 1 ] == '-'))
+		{
+			ErrPrint("Invalid parameter '%s'.\n", arg);
+			return RESULT_PARAM_ERR;
+		}
+		else if (matchContextName == NULL)
+		{
+			matchContextName = PrvResolveContextNameAlias(arg);
+		}
+		else
+		{
+			ErrPrint("Invalid parameter '%s'\n", arg);
+			return RESULT_PARAM_ERR;
+		}
+	}
+
+	contextInfos = (ContextsInfo_t *) malloc(sizeof(*contextInfos));
+
+	if (!contextInfos)
+	{
+		ErrPrint("Out of memory.\n");
+		return RESULT_RUN_ERR;
+	}
+
+	logErr = PrvGetContextList(contextInfos, matchContextName);
+
+	if (logErr != kPmLogErr_None)
+	{
+		ErrPrint("Error getting contexts info: 0x%08X (%s)\n", logErr,
+		         PmLogGetErrDbgString(logErr));
+		free(contextInfos);
+		return RESULT_RUN_ERR;
+	}
+
+	if (matchContextName != NULL)
+	{
+		if (contextInfos->numContexts == 0)
+		{
+			if (PrvIsWildcardContextName(matchContextName))
+			{
+				ErrPrint("No contexts matched '%s'.\n", matchContextName);
+			}
+			else
+			{
+				ErrPrint("Context '%s' not found.\n", matchContextName);
+			}
+
+			free(contextInfos);
+			return RESULT_RUN_ERR;
+		}
+	}
+
+	wasLevels = NULL;
+
+	if (snapshotPath != NULL)
+	{
+		wasLevels = (int *) malloc((contextInfos->numContexts + 1) * sizeof(int));
+
+		if (wasLevels == NULL)
+		{
+			ErrPrint("Out of memory.\n");
+			free(contextInfos);
+			return RESULT_RUN_ERR;
+		}
+
+		for (i = 0; i < contextInfos->numContexts; i++)
+		{
+			wasLevels[ i ] = SHOW_LEVEL_ABSENT;
+		}
+
+		result = PrvReadShowSnapshot(snapshotPath, contextInfos, wasLevels);
+
+		if (result != RESULT_OK)
+		{
+			free(wasLevels);
+			free(contextInfos);
+			return result;
+		}
+	}
+
+	result = PrvShowContexts(contextInfos, format, wasLevels);
+
+	free(wasLevels);
+	free(contextInfos);
+	return result;
+}
+
+
+/*
+ * The file whose reload by "reconf" can change any context's level.
+ */
+#ifndef PMLOGCTL_CONTEXTS_CONF_PATH
+#define PMLOGCTL_CONTEXTS_CONF_PATH "/etc/PmLogContexts.conf"
+#endif
+
+#define PMLOGCTL_WATCH_DEFAULT_MSECS    250
+
+
+/**
+ * WatchState_t
+ *
+ * The watched contexts and their levels when last shown.  The
+ * ContextInfo_t's point at the contexts in PmLogLib's shared memory,
+ * so checking for changes only reads their levels.
+ */
+typedef struct
+{
+	const char         *matchContextName;
+	int                 numAllContexts;
+	ContextsInfo_t     *contextInfos;
+	int                *lastLevels;
+}
+WatchState_t;
+
+
+/**
+ * @brief PrvWatchRelist
+ *
+ * Re-list the matching contexts after the number of contexts changed,
+ * keeping the last levels of those already watched; new ones are
+ * SHOW_LEVEL_ABSENT.
+ *
+ * @return RESULT_OK, or an error which has been reported.
+ */
+static Result PrvWatchRelist(WatchState_t *stateP)
+{
+	ContextsInfo_t         *newInfos;
+	int                    *newLevels;
+	ContextNameIndex_t      index;
+	const ContextInfo_t    *contextInfoP;
+	PmLogErr                logErr;
+	int                     i;
+
+	newInfos = (ContextsInfo_t *) malloc(sizeof(*newInfos));
+	newLevels = (int *) malloc((PMLOG_MAX_NUM_CONTEXTS + 1) * sizeof(int));
+
+	if ((newInfos == NULL) || (newLevels == NULL))
+	{
+		ErrPrint("Out of memory.\n");
+		free(newInfos);
+		free(newLevels);
+		return RESULT_RUN_ERR;
+	}
+
+	logErr = PrvGetContextList(newInfos, stateP->matchContextName);
+
+	if (logErr != kPmLogErr_None)
+	{
+		ErrPrint("Error getting contexts info: 0x%08X (%s)\n", logErr,
+		         PmLogGetErrDbgString(logErr));
+		free(newInfos);
+		free(newLevels);
+		return RESULT_RUN_ERR;
+	}
+
+	for (i = 0; i < newInfos->numContexts; i++)
+	{
+		newLevels[ i ] = SHOW_LEVEL_ABSENT;
+	}
+
+	if (stateP->contextInfos != NULL)
+	{
+		if (!PrvBuildContextNameIndex(newInfos, &index))
+		{
+			ErrPrint("Out of memory.\n");
+			free(newInfos);
+			free(newLevels);
+			return RESULT_RUN_ERR;
+		}
+
+		for (i = 0; i < stateP->contextInfos->numContexts; i++)
+		{
+			contextInfoP = PrvFindContextInfo(newInfos, &index,
+			                                  stateP->contextInfos->contextInfos[ i ].contextName);
+
+			if (contextInfoP != NULL)
+			{
+				newLevels[ contextInfoP - newInfos->contextInfos ] =
+				    stateP->lastLevels[ i ];
+			}
+		}
+
+		free(index.slots);
+	}
+
+	free(stateP->contextInfos);
+	free(stateP->lastLevels);
+	stateP->contextInfos = newInfos;
+	stateP->lastLevels = newLevels;
+
+	return RESULT_OK;
+}
+
+
+/**
+ * @brief PrvWatchCheck
+ *
+ * Show the watched contexts whose level is not the last shown, if any.
+ * This is what is done on every tick, so unless the number of contexts
+ * changed it neither lists nor allocates anything.
+ *
+ * @return RESULT_OK, or an error which has been reported.
+ */
+static Result PrvWatchCheck(WatchState_t *stateP, ShowFormat_t format)
+{
+	PmLogErr        logErr;
+	Result          result;
+	int             n;
+	int             i;
+	bool            initial;
+	bool            changed;
+
+	n = 0;
+	logErr = PmLogGetNumContexts(&n);
+
+	if (logErr != kPmLogErr_None)
+	{
+		ErrPrint("Error getting contexts info: 0x%08X (%s)\n", logErr,
+		         PmLogGetErrDbgString(logErr));
+		return RESULT_RUN_ERR;
+	}
+
+	initial = (stateP->contextInfos == NULL);
+
+	if (initial || (stateP->numAllContexts != n))
+	{
+		result = PrvWatchRelist(stateP);
+
+		if (result != RESULT_OK)
+		{
+			return result;
+		}
+
+		stateP->numAllContexts = n;
+	}
+
+	changed = false;
+
+	for (i = 0; i < stateP->contextInfos->numContexts; i++)
+	{
+		if (stateP->lastLevels[ i ] !=
+		        stateP->contextInfos->contextInfos[ i ].context->enabledLevel)
+		{
+			changed = true;
+			break;
+		}
+	}
+
+	if (!changed)
+	{
+		return RESULT_OK;
+	}
+
+	/* at first show them as for show */
+	result = PrvShowContexts(stateP->contextInfos, format,
+	                         initial ? NULL : stateP->lastLevels);
+
+	for (i = 0; i < stateP->contextInfos->numContexts; i++)
+	{
+		stateP->lastLevels[ i ] =
+		    stateP->contextInfos->contextInfos[ i ].context->enabledLevel;
+	}
+
+	return result;
+}
+
+
+/**
+ * @brief PrvWatchNowMsec
+ */
+static int64_t PrvWatchNowMsec(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+
+/**
+ * @brief DoCmdWatch
+ *
+ * Usage: watch [--json | --tsv] [--interval <msec>] [<context>]
+ *
+ * Show the matching contexts, as for show, then each time any of
+ * their levels change show those that did.  This runs until
+ * interrupted.
+ *
+ * PmLogLib has no change notification, so the levels are checked
+ * every interval, which is cheap, and at once on inotify events for
+ * the contexts configuration file, which "reconf" reloads.
+ */
+static Result DoCmdWatch(int argc, char *argv[])
+{
+	__attribute__((aligned(__alignof__(struct inotify_event))))
+	char            buff[ 4096 ];
+	const struct inotify_event *eventP;
+	WatchState_t    state;
+	ShowFormat_t    format;
+	long            intervalMsecs;
+	char            confDir[ PATH_MAX ];
+	const char     *confName;
+	const char     *arg;
+	char           *end;
+	struct pollfd   pfd;
+	int             inotifyFd;
+	int             watchDesc;
+	int             argIndex;
+	Result          result;
+	ssize_t         n;
+	ssize_t         pos;
+	int64_t         nowMsec;
+	int64_t         nextCheckMsec;
+	int64_t         waitMsec;
+	bool            confChanged;
+
+	memset(&state, 0, sizeof(state));
+	format = SHOW_FORMAT_TEXT;
+	intervalMsecs = PMLOGCTL_WATCH_DEFAULT_MSECS;
+
+	argIndex = 1;
+
+	while (argIndex < argc)
+	{
+		arg = argv[ argIndex++ ];
+
+		if (strcmp(arg, "--json") == 0)
+		{
+			format = SHOW_FORMAT_JSON;
+		}
+		else if (strcmp(arg, "--tsv") == 0)
+		{
+			format = SHOW_FORMAT_TSV;
+		}
+		else if (strcmp(arg, "--interval") == 0)
+		{
+			if (argIndex >= argc)
+			{
+				ErrPrint("Invalid parameter: %s requires value\n", arg);
+				return RESULT_PARAM_ERR;
+			}
+
+			arg = argv[ argIndex++ ];
+			errno = 0;
+			intervalMsecs = strtol(arg, &end, 10);
+
+			if ((errno != 0) || (end == arg) || (*end != 0) ||
+			        (intervalMsecs <= 0) || (intervalMsecs > INT_MAX))
+			{
+				ErrPrint("Invalid interval '%s'.\n", arg);
+				return RESULT_PARAM_ERR;
+			}
+		}
+		else if ((arg[ 0 ] == '-') && (arg[ 1 ] == '-'))
+		{
+			ErrPrint("Invalid parameter '%s'.\n", arg);
+			return RESULT_PARAM_ERR;
+		}
+		else if (state.matchContextName == NULL)
+		{
+			state.matchContextName = PrvResolveContextNameAlias(arg);
+		}
+		else
+		{
+			ErrPrint("Invalid parameter '%s'\n", arg);
+			return RESULT_PARAM_ERR;
+		}
+	}
+
+	/* watch the directory, as the file may be replaced or not exist yet */
+	mysprintf(confDir, sizeof(confDir), "%s", PMLOGCTL_CONTEXTS_CONF_PATH);
+	end = strrchr(confDir, '/');
+
+	if (end == NULL)
+	{
+		/* a relative name, in the current directory */
+		confName = PMLOGCTL_CONTEXTS_CONF_PATH;
+		mystrcpy(confDir, sizeof(confDir), ".");
+	}
+	else
+	{
+		confName = PMLOGCTL_CONTEXTS_CONF_PATH + (end - confDir) + 1;
+		*end = 0;
+	}
+
+	watchDesc = -1;
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (inotifyFd >= 0)
+	{
+		watchDesc = inotify_add_watch(inotifyFd, confDir,
+		                              IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+
+		if (watchDesc < 0)
+		{
+			(void) close(inotifyFd);
+			inotifyFd = -1;
+		}
+	}
+
+	result = PrvWatchCheck(&state, format);
+
+	if ((result == RESULT_OK) && (state.contextInfos->numContexts == 0) &&
+	        (state.matchContextName != NULL) &&
+	        !PrvIsWildcardContextName(state.matchContextName))
+	{
+		ErrPrint("Context '%s' not found.\n", state.matchContextName);
+		result = RESULT_RUN_ERR;
+	}
+
+	nextCheckMsec = PrvWatchNowMsec() + intervalMsecs;
+
+	/*
+	 * check when the interval is up, whatever else is going on in the
+	 * directory, or sooner if the file changed
+	 */
+	while (result == RESULT_OK)
+	{
+		pfd.fd = inotifyFd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+
+		confChanged = false;
+		waitMsec = nextCheckMsec - PrvWatchNowMsec();
+
+		if (waitMsec < 0)
+		{
+			waitMsec = 0;
+		}
+
+		if (poll(&pfd, 1, (int) waitMsec) > 0)
+		{
+			while ((n = read(inotifyFd, buff, sizeof(buff))) > 0)
+			{
+				for (pos = 0; pos < n; pos += sizeof(*eventP) + eventP->len)
+				{
+					eventP = (const struct inotify_event *)(buff + pos);
+
+					if ((eventP->wd == watchDesc) && (eventP->len > 0) &&
+					        (strcmp(eventP->name, confName) == 0))
+					{
+						confChanged = true;
+					}
+				}
+			}
+		}
+
+		nowMsec = PrvWatchNowMsec();
+
+		if (!confChanged && (nowMsec < nextCheckMsec))
+		{
+			continue;
+		}
+
+		result = PrvWatchCheck(&state, format);
+		nextCheckMsec = nowMsec + intervalMsecs;
+	}
+
+	if (inotifyFd >= 0)
+	{
+		(void) close(inotifyFd);
+	}
+
+	free(state.contextInfos);
+	free(state.lastLevels);
+
+	return result;
+}
+
+
+/**
+ * SetItem_t
+ *
+ * One context level change of a batch set.  contextName is owned.
+ */
+typedef struct
+{
+	char           *contextName;
+	int             level;
+}
+SetItem_t;
+
+
+typedef struct
+{
+	int             numItems;
+	int             maxItems;
+	SetItem_t      *items;
+}
+SetItems_t;
+
+
+/**
+ * @brief PrvAddSetItem
+ *
+ * Add "<context>=<level>" or "<context> <level>", i.e. the first
+ * contextNameLen chars of s are the name and levelStr is the level.
+ * @return RESULT_OK, or an error which has been reported.
+ */
+static Result PrvAddSetItem(SetItems_t *itemsP, const char *s,
+                            size_t contextNameLen, const char *levelStr,
+                            const char *where)
+{
+	const int  *levelIntP;
+	SetItem_t  *newItems;
+	char       *contextName;
+
+	if (contextNameLen == 0)
+	{
+		ErrPrint("%sContext not specified.\n", where);
+		return RESULT_PARAM_ERR;
+	}
+
+	levelIntP = PmLogStringToLevel(levelStr);
+
+	if (levelIntP == NULL)
+	{
+		ErrPrint("%sInvalid level '%s'.\n", where, levelStr);
+		return RESULT_PARAM_ERR;
+	}
+
+	if (itemsP->numItems >= itemsP->maxItems)
+	{
+		itemsP->maxItems = (itemsP->maxItems > 0) ? 2 * itemsP->maxItems : 16;
+		newItems = (SetItem_t *) realloc(itemsP->items,
+		                                 itemsP->maxItems * sizeof(SetItem_t));
+
+		if (newItems == NULL)
+		{
+			ErrPrint("Out of memory.\n");
+			return RESULT_RUN_ERR;
+		}
+
+		itemsP->items = newItems;
+	}
+
+	contextName = strndup(s, contextNameLen);
+
+	if (contextName == NULL)
+	{
+		ErrPrint("Out of memory.\n");
+		return RESULT_RUN_ERR;
+	}
+
+	itemsP->items[ itemsP->numItems ].contextName = contextName;
+	itemsP->items[ itemsP->numItems ].level = *levelIntP;
+	itemsP->numItems++;
+
+	return RESULT_OK;
+}
+
+
+/**
+ * @brief PrvReadSetFile
+ *
+ * Read a file of "<context> <level>" or "<context>=<level>" lines, or
+ * stdin if the path is "-".  Blank lines and lines starting with '#'
+ * are skipped.
+ * @return RESULT_OK, or an error which has been reported.
+ */
+static Result PrvReadSetFile(SetItems_t *itemsP, const char *path)
+{
+	FILE       *f;
+	char       *line;
+	size_t      lineSize;
+	ssize_t     n;
+	int         lineNum;
+	char       *s;
+	char       *end;
+	char       *sep;
+	char       *levelStr;
+	char        where[ PATH_MAX + 32 ];
+	Result      result;
+	Result      lineResult;
+	int         err;
+
+	if (strcmp(path, "-") == 0)
+	{
+		f = stdin;
+	}
+	else
+	{
+		f = fopen(path, "r");
+
+		if (f == NULL)
+		{
+			err = errno;
+			ErrPrint("Error opening '%s': %s\n", path, strerror(err));
+			return RESULT_PARAM_ERR;
+		}
+	}
+
+	result = RESULT_OK;
+	line = NULL;
+	lineSize = 0;
+	lineNum = 0;
+
+	while ((n = getline(&line, &lineSize, f)) >= 0)
+	{
+		lineNum++;
+
+		/* trim leading and trailing white space */
+		s = line;
+		end = line + n;
+
+		while ((s < end) && isspace((unsigned char) *s))
+		{
+			s++;
+		}
+
+		while ((end > s) && isspace((unsigned char) end[ -1 ]))
+		{
+			end--;
+		}
+
+		*end = 0;
+
+		if ((*s == 0) || (*s == '#'))
+		{
+			continue;
+		}
+
+		mysprintf(where, sizeof(where), "%s:%d: ", path, lineNum);
+
+		sep = strpbrk(s, "= \t");
+
+		if (sep == NULL)
+		{
+			ErrPrint("%sLevel not specified.\n", where);
+			result = RESULT_PARAM_ERR;
+			continue;
+		}
+
+		/* the level follows white space and/or '=' */
+		levelStr = sep;
+
+		while (isspace((unsigned char) *levelStr))
+		{
+			levelStr++;
+		}
+
+		if (*levelStr == '=')
+		{
+			levelStr++;
+		}
+
+		while (isspace((unsigned char) *levelStr))
+		{
+			levelStr++;
+		}
+
+		lineResult = PrvAddSetItem(itemsP, s, sep - s, levelStr, where);
+
+		if (lineResult == RESULT_RUN_ERR)
+		{
+			result = lineResult;
+			break;
+		}
+
+		if (lineResult != RESULT_OK)
+		{
+			result = lineResult;
+		}
+	}
+
+	free(line);
+
+	if (f != stdin)
+	{
+		(void) fclose(f);
+	}
+
+	return result;
+}
+
+
+/**
+ * @brief PrvSetContextLevel
+ */
+static Result PrvSetContextLevel(const ContextInfo_t *contextInfoP, int level)
+{
+	PmLogErr    logErr;
+
+	ErrPrint("Setting context level for '%s'.\n", contextInfoP->contextName);
+
+	logErr = PmLogSetContextLevel(contextInfoP->context, level);
+
+	if (logErr != kPmLogErr_None)
+	{
+		ErrPrint("Error setting context log level: 0x%08X (%s)\n", logErr,
+		         PmLogGetErrDbgString(logErr));
+		return RESULT_RUN_ERR;
+	}
+
+	return RESULT_OK;
+}
+
+
+/**
+ * @brief PrvDoSetItems
+ *
+ * Apply a batch of level changes, in order.  The contexts are listed
+ * once for all of them, and every name is checked before anything is
+ * changed.
+ */
+static Result PrvDoSetItems(const SetItems_t *itemsP)
+{
+	ContextsInfo_t         *contextInfos;
+	ContextNameIndex_t      index;
+	const ContextInfo_t    *contextInfoP;
+	const char             *contextName;
+	PmLogErr                logErr;
+	Result                  result;
+	bool                    matched;
+	int                     i;
+	int                     j;
+	int                     pass;
+	bool                    setFailed;
+
+	contextInfos = (ContextsInfo_t *) malloc(sizeof(*contextInfos));
+
+	if (!contextInfos)
+	{
+		ErrPrint("Out of memory.\n");
+		return RESULT_RUN_ERR;
+	}
+
+	logErr = PrvGetContextList(contextInfos, NULL);
+
+	if (logErr != kPmLogErr_None)
+	{
+		ErrPrint("Error getting contexts info: 0x%08X (%s)\n", logErr,
+		         PmLogGetErrDbgString(logErr));
+		free(contextInfos);
+		return RESULT_RUN_ERR;
+	}
+
+	if (!PrvBuildContextNameIndex(contextInfos, &index))
+	{
+		ErrPrint("Out of memory.\n");
+		free(contextInfos);
+		return RESULT_RUN_ERR;
+	}
+
+	result = RESULT_OK;
+	setFailed = false;
+
+	/* first check them all, then if that went well set them all */
+	for (pass = 0; (pass < 2) && (result == RESULT_OK); pass++)
+	{
+		for (i = 0; (i < itemsP->numItems) && !setFailed; i++)
+		{
+			contextName = PrvResolveContextNameAlias(itemsP->items[ i ].contextName);
+
+			if (!PrvIsWildcardContextName(contextName))
+			{
+				contextInfoP = PrvFindContextInfo(contextInfos, &index,
+				                                  contextName);
+
+				if (contextInfoP == NULL)
+				{
+					ErrPrint("Context '%s' not found.\n", contextName);
+					result = RESULT_PARAM_ERR;
+				}
+				else if (pass == 1)
+				{
+					result = PrvSetContextLevel(contextInfoP,
+					                            itemsP->items[ i ].level);
+					setFailed = (result != RESULT_OK);
+				}
+
+				continue;
+			}
+
+			matched = false;
+
+			for (j = 0; (j < contextInfos->numContexts) && !setFailed;
+			        j++)
+			{
+				contextInfoP = &contextInfos->contextInfos[ j ];
+
+				if (!PrvMatchContextName(contextInfoP->contextName, contextName))
+				{
+					continue;
+				}
+
+				matched = true;
+
+				if (pass == 1)
+				{
+					result = PrvSetContextLevel(contextInfoP,
+					                            itemsP->items[ i ].level);
+					setFailed = (result != RESULT_OK);
+				}
+			}
+
+			if (!matched)
+			{
+				ErrPrint("No contexts matched '%s'.\n", contextName);
+				result = RESULT_RUN_ERR;
+			}
+		}
+	}
+
+	free(index.slots);
+	free(contextInfos);
+
+	return result;
+}
+
+
+/**
+ * @brief DoCmdSetBatch
+ *
+ * Usage: set <context>=<level> ... [-f <file>] ...
+ *
+ * Set many context levels at once, from the arguments and files in
+ * the order given.
  */
-static Result DoCmdShow(int argc, char *argv[])
+static Result DoCmdSetBatch(int argc, char *argv[])
 {
-	const char     *matchContextName;
-	ContextsInfo_t     *contextInfos = NULL;
-	PmLogErr        logErr;
+	SetItems_t      items;
 	int             i;
-	ContextInfo_t  *contextInfoP;
+	const char     *arg;
+	const char     *sep;
+	char            where[ 64 ];
+	Result          result;
+	Result          argResult;
 
-	matchContextName = NULL;
+	memset(&items, 0, sizeof(items));
 
-	if (argc >= 2)
-	{
-		matchContextName = argv[ 1 ];
-		matchContextName = PrvResolveContextNameAlias(matchContextName);
-	}
+	result = RESULT_OK;
+	i = 1;
 
-	if (argc >= 3)
+	while ((i < argc) && (result != RESULT_RUN_ERR))
 	{
-		ErrPrint("Invalid parameter '%s'\n", argv[2]);
-		return RESULT_PARAM_ERR;
-	}
+		arg = argv[ i ];
 
-	contextInfos = (ContextsInfo_t *) malloc(sizeof(*contextInfos));
+		if (strcmp(arg, "-f") == 0)
+		{
+			i++;
 
-	if (!contextInfos)
-	{
-		ErrPrint("Out of memory.\n");
-		return RESULT_RUN_ERR;
-	}
+			if (i >= argc)
+			{
+				ErrPrint("Invalid parameter: %s requires value\n", arg);
+				result = RESULT_PARAM_ERR;
+				break;
+			}
 
-	logErr = PrvGetContextList(contextInfos, matchContextName);
+			argResult = PrvReadSetFile(&items, argv[ i ]);
+		}
+		else if ((sep = strchr(arg, '=')) != NULL)
+		{
+			mysprintf(where, sizeof(where), "Parameter %d: ", i);
+			argResult = PrvAddSetItem(&items, arg, sep - arg, sep + 1, where);
+		}
+		else
+		{
+			ErrPrint("Invalid parameter '%s'.\n", arg);
+			argResult = RESULT_PARAM_ERR;
+		}
 
-	if (logErr != kPmLogErr_None)
-	{
-		ErrPrint("Error getting contexts info: 0x%08X (%s)\n", logErr,
-		         PmLogGetErrDbgString(logErr));
-		free(contextInfos);
-		return RESULT_RUN_ERR;
+		if (argResult != RESULT_OK)
+		{
+			result = argResult;
+		}
+
+		i++;
 	}
 
-	for (i = 0; i < contextInfos->numContexts; i++)
+	if ((result == RESULT_OK) && (items.numItems == 0))
 	{
-		contextInfoP = &contextInfos->contextInfos[ i ];
-		ShowContext(contextInfoP);
+		ErrPrint("Context not specified.\n");
+		result = RESULT_PARAM_ERR;
 	}
 
-	if (matchContextName != NULL)
+	if (result == RESULT_OK)
 	{
-		if (contextInfos->numContexts == 0)
-		{
-			if (PrvIsWildcardContextName(matchContextName))
-			{
-				ErrPrint("No contexts matched '%s'.\n", matchContextName);
-			}
-			else
-			{
-				ErrPrint("Context '%s' not found.\n", matchContextName);
-			}
+		result = PrvDoSetItems(&items);
+	}
 
-			free(contextInfos);
-			return RESULT_RUN_ERR;
-		}
+	for (i = 0; i < items.numItems; i++)
+	{
+		free(items.items[ i ].contextName);
 	}
 
-	free(contextInfos);
-	return RESULT_OK;
+	free(items.items);
+
+	return result;
 }
 
 
@@ -417,9 +1796,11 @@ static Result DoCmdShow(int argc, char *argv[])
  * @brief DoCmdSet
  *
  * Usage: set <context> <level>        # set logging context level
+ *        set <context>=<level> ... [-f <file>] ...
  *
  * Set the active logging level for the specified context.
  * If the context does not already exist, it is an error.
+ * The second form sets many at once, see DoCmdSetBatch.
  */
 static Result DoCmdSet(int argc, char *argv[])
 {
@@ -436,6 +1817,12 @@ static Result DoCmdSet(int argc, char *argv[])
 	matchedContext = NULL;
 	levelIntP = NULL;
 
+	if ((argc >= 2) &&
+	        ((strcmp(argv[ 1 ], "-f") == 0) || (strchr(argv[ 1 ], '=') != NULL)))
+	{
+		return DoCmdSetBatch(argc, argv);
+	}
+
 	i = 1;
 
 	while (i < argc)
@@ -866,45 +2253,162 @@ static Result DoCmdLogKV(int argc, char *argv[])
 }
 
 
+/*
+ * the longest kernel record we'll write, "<priority>" and newline
+ * included: the kernel rejects a write longer than LOG_LINE_MAX, which
+ * is 976 to 992 bytes depending on its version, so longer messages are
+ * cut to fit
+ */
+#define PMLOGCTL_KMSG_MAX_RECORD    976
+
+
 /**
- * @brief WriteKMsg
+ * KMsgStats_t
  *
- * Write a kernel message.
+ * What happened to the records written to /dev/kmsg.
  */
-static Result WriteKMsg(int priority, const char *msgStr)
+typedef struct
+{
+	unsigned long   records;
+	unsigned long   bytes;
+	unsigned long   errors;
+	unsigned long   eagains;
+}
+KMsgStats_t;
+
+
+/**
+ * @brief PrvOpenKMsg
+ *
+ * Open /dev/kmsg for writing, unbuffered.
+ * @return the fd, or -1 if it can't be opened.
+ */
+static int PrvOpenKMsg(void)
 {
 	const char *kKMsgPath = "/dev/kmsg";
 
-	FILE   *f;
+	int     fd;
 	int     err;
-	char    priorityStr[ 8 ];
-	int     n;
-	Result  result;
 
-	f = fopen(kKMsgPath, "w");
+	fd = open(kKMsgPath, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
 
-	if (f == NULL)
+	if (fd < 0)
 	{
 		err = errno;
-		ErrPrint("Error opening %s: %s", kKMsgPath, strerror(err));
-		return RESULT_RUN_ERR;
+		ErrPrint("Error opening %s: %s\n", kKMsgPath, strerror(err));
 	}
 
+	return fd;
+}
+
+
+/**
+ * @brief PrvWriteKMsgRecord
+ *
+ * Write the message as one kernel record, prefixed by "<priority>"
+ * unless priority is -1, and cut to PMLOGCTL_KMSG_MAX_RECORD.  The
+ * whole record goes in a single write, so it is never merged with or
+ * split from another.  If the kernel can't take it right away, wait a
+ * little and retry.
+ * @return true if written, else false with errno set, or 0 after a
+ * short write.
+ */
+static bool PrvWriteKMsgRecord(int fd, int priority, const char *msg,
+                               size_t msgLen, KMsgStats_t *statsP)
+{
+	char            record[ PMLOGCTL_KMSG_MAX_RECORD ];
+	size_t          len;
+	ssize_t         n;
+	int             tries;
+	struct pollfd   pfd;
+
+	len = 0;
+
 	if (priority >= 0)
 	{
-		mysprintf(priorityStr, sizeof(priorityStr), "<%d>", priority);
+		mysprintf(record, sizeof(record), "<%d>", priority);
+		len = strlen(record);
 	}
-	else
+
+	if (msgLen > sizeof(record) - len - 1)
+	{
+		msgLen = sizeof(record) - len - 1;
+	}
+
+	memcpy(record + len, msg, msgLen);
+	len += msgLen;
+	record[ len++ ] = '\n';
+
+	for (tries = 0; ; tries++)
+	{
+		n = write(fd, record, len);
+
+		if (n >= 0)
+		{
+			break;
+		}
+
+		if (errno == EINTR)
+		{
+			continue;
+		}
+
+		if ((errno != EAGAIN) || (tries >= 10))
+		{
+			break;
+		}
+
+		statsP->eagains++;
+
+		pfd.fd = fd;
+		pfd.events = POLLOUT;
+		(void) poll(&pfd, 1, 100);
+	}
+
+	if (n != (ssize_t) len)
+	{
+		if (n >= 0)
+		{
+			errno = 0;
+		}
+
+		statsP->errors++;
+		return false;
+	}
+
+	statsP->records++;
+	statsP->bytes += len;
+
+	return true;
+}
+
+
+/**
+ * @brief WriteKMsg
+ *
+ * Write a kernel message.
+ */
+static Result WriteKMsg(int priority, const char *msgStr)
+{
+	int             fd;
+	int             err;
+	KMsgStats_t     stats;
+	Result          result;
+
+	fd = PrvOpenKMsg();
+
+	if (fd < 0)
 	{
-		priorityStr[ 0 ] = 0;
+		return RESULT_RUN_ERR;
 	}
 
-	n = fprintf(f, "%s%s\n", priorityStr, msgStr);
+	memset(&stats, 0, sizeof(stats));
 
-	if (n < 0)
+	if (!PrvWriteKMsgRecord(fd, priority, msgStr, strlen(msgStr), &stats))
 	{
 		err = errno;
-		ErrPrint("Error writing %s: %s", kKMsgPath, strerror(err));
+		ErrPrint("Error writing /dev/kmsg: %s\n",
+		         (err != 0) ? strerror(err) : "short write");
 		result = RESULT_RUN_ERR;
 	}
 	else
@@ -912,16 +2416,106 @@ static Result WriteKMsg(int priority, const char *msgStr)
 		result = RESULT_OK;
 	}
 
-	(void) fclose(f);
+	(void) close(fd);
 
 	return result;
 }
 
 
+/**
+ * @brief PrvHasKMsgPriority
+ *
+ * @return true if the line starts with its own "<priority>".
+ */
+static bool PrvHasKMsgPriority(const char *line, size_t len)
+{
+	size_t  i;
+
+	if ((len < 3) || (line[ 0 ] != '<'))
+	{
+		return false;
+	}
+
+	for (i = 1; (i < len) && isdigit((unsigned char) line[ i ]); i++)
+	{
+	}
+
+	return (i > 1) && (i < len) && (line[ i ] == '>');
+}
+
+
+/**
+ * @brief WriteKMsgStream
+ *
+ * Write each line read from stdin as a kernel message, over one open
+ * /dev/kmsg.  Lines that start with "<priority>" keep it, the others
+ * get the given priority.  Empty lines are skipped.
+ */
+static Result WriteKMsgStream(int priority)
+{
+	int             fd;
+	char           *line;
+	size_t          lineSize;
+	ssize_t         lineLen;
+	KMsgStats_t     stats;
+	struct timeval  startTv;
+	struct timeval  endTv;
+	double          secs;
+
+	fd = PrvOpenKMsg();
+
+	if (fd < 0)
+	{
+		return RESULT_RUN_ERR;
+	}
+
+	memset(&stats, 0, sizeof(stats));
+	line = NULL;
+	lineSize = 0;
+
+	(void) gettimeofday(&startTv, NULL);
+
+	while ((lineLen = getline(&line, &lineSize, stdin)) >= 0)
+	{
+		while ((lineLen > 0) && ((line[ lineLen - 1 ] == '\n') ||
+		                         (line[ lineLen - 1 ] == '\r')))
+		{
+			lineLen--;
+		}
+
+		if (lineLen == 0)
+		{
+			continue;
+		}
+
+		(void) PrvWriteKMsgRecord(fd,
+		                          PrvHasKMsgPriority(line, (size_t) lineLen) ?
+		                          -1 : priority,
+		                          line, (size_t) lineLen, &stats);
+	}
+
+	(void) gettimeofday(&endTv, NULL);
+
+	free(line);
+	(void) close(fd);
+
+	secs = (endTv.tv_sec - startTv.tv_sec) +
+	       (endTv.tv_usec - startTv.tv_usec) / 1e6;
+
+	printf("klog: %lu records (%lu bytes) in %.3f sec (%.0f records/sec), "
+	       "%lu errors, %lu EAGAIN\n", stats.records, stats.bytes, secs,
+	       (secs > 0) ? stats.records / secs : 0.0, stats.errors,
+	       stats.eagains);
+
+	return (stats.errors == 0) ? RESULT_OK : RESULT_RUN_ERR;
+}
+
+
 /**
  * @brief DoCmdKLog
  *
  * Usage: klog [-p <level>] <msg>  # log a message
+ *        klog [-p <level>] -      # log each line read from stdin
  *
  * Test a call through printk.
  */
@@ -944,7 +2538,7 @@ static Result DoCmdKLog(int argc, char *argv[])
 	{
 		arg = argv[ i ];
 
-		if (arg[ 0 ] == '-')
+		if ((arg[ 0 ] == '-') && (arg[ 1 ] != 0))
 		{
 			if (strcmp(arg, "-p") == 0)
 			{
@@ -993,6 +2587,11 @@ static Result DoCmdKLog(int argc, char *argv[])
 	}
 
 #if 1
+	if (strcmp(msg, "-") == 0)
+	{
+		result = WriteKMsgStream(level);
+	}
+	else
 	{
 		result = WriteKMsg(level, msg);
 	}
@@ -1012,7 +2611,7 @@ static Result DoCmdKLog(int argc, char *argv[])
  *
  * Usage: flush
  */
-static Result DoCmdFlush()
+static Result DoCmdFlush(int argc, char *argv[])
 {
 	PmLogErr        logErr;
 	PmLogContext    context;
@@ -1195,9 +2794,55 @@ static void ShowUsage(void)
 	ErrPrint("                               # If you want value be a string, use quoting => <key>=<\\\"value\\\">\n");
 	ErrPrint("                               # Debug level message takes only freetext. msgID and key-value pairs are not needed\n");
 	ErrPrint("  klog [-p <level>] <msg>      # log a kernel message\n");
+	ErrPrint("  klog [-p <level>] -          # log each line from stdin as a kernel message\n");
 	ErrPrint("  reconf                       # re-load lib options from conf\n");
 	ErrPrint("  set <context> <level>        # set logging context level\n");
+	ErrPrint("  set <context>=<level> ... [-f <file>]\n");
+	ErrPrint("                               # set many context levels, from args and files\n");
+	ErrPrint("                               # of '<context> <level>' lines, '-' for stdin\n");
 	ErrPrint("  show [<context>]             # show logging context(s)\n");
+	ErrPrint("    --json | --tsv             # as JSON or TSV to stdout\n");
+	ErrPrint("    --diff <snapshot>          # only those changed since a --tsv snapshot\n");
+	ErrPrint("  watch [--json | --tsv] [--interval <msec>] [<context>]\n");
+	ErrPrint("                               # show context(s), then level changes\n");
+	ErrPrint("  flood [--count <n>] [--rate <msgs/sec>] [--threads <n>]\n");
+	ErrPrint("        [--context <contexts>] [--level <levels>]\n");
+	ErrPrint("        [--api print|string|both] [--settle <msec>] [--no-check]\n");
+	ErrPrint("                               # send many messages and measure them\n");
+	ErrPrint("  shell                        # run commands read from stdin, one per line\n");
+	ErrPrint("  serve <socket path>          # run commands from clients of a Unix socket\n");
+#ifdef PMLOGCTL_BENCH
+	ErrPrint("  bench [--lines <n>] [--reps <n>] [--dir <dir>]\n");
+	ErrPrint("                               # time the view stages on generated logs\n");
+#endif
+	ErrPrint("  view [<options>]             # view the merged log files\n");
+	ErrPrint("    --since <time>             # only lines at or after <time>\n");
+	ErrPrint("    --until <time>             # only lines at or before <time>\n");
+	ErrPrint("    --context <patterns>       # only lines of matching contexts, e.g. \"Foo*,Bar\"\n");
+	ErrPrint("    --program <patterns>       # only lines of matching programs\n");
+	ErrPrint("    --level <levels>           # only lines of these levels, e.g. \"err,crit\"\n");
+	ErrPrint("    --min-level <level>        # only lines of this level or more severe\n");
+	ErrPrint("    --facility <facilities>    # only lines of these facilities\n");
+	ErrPrint("    --index-dir <dir>          # keep time indexes of old segments in <dir>\n");
+	ErrPrint("    --dedup-window <msec>      # drop lines also logged elsewhere within <msec>\n");
+	ErrPrint("    --parallel                 # read, merge and write on separate threads\n");
+	ErrPrint("    --follow                   # keep showing new lines as they are logged\n");
+	ErrPrint("    --kmsg                     # merge in the kernel ring buffer too (lines already\n");
+	ErrPrint("                               # logged show twice without --dedup-window)\n");
+	ErrPrint("    --profile                  # report line counts and stage times on stderr\n");
+	ErrPrint("    --binary                   # write length-prefixed binary records, not text\n");
+	ErrPrint("    --json                     # write JSON lines, with msgID and key/values split out\n");
+	ErrPrint("    --stats                    # instead of the lines, show which contexts are noisiest\n");
+	ErrPrint("    --top <n>                  # how many to show with --stats, default 10\n");
+	ErrPrint("    -o <file>                  # write to <file>, compressed if it ends in .gz or .zst\n");
+	ErrPrint("    --compress gzip|zstd|none  # compress the output, on a thread of its own\n");
+	ErrPrint("    --max-size <bytes>[K|M|G]  # stop before the line that would go over the size\n");
+	ErrPrint("\n");
+
+	ErrPrint("Times:\n");
+	ErrPrint("  2013-04-12T23:20:50[.52][Z]  # UTC\n");
+	ErrPrint("  Apr 12 16:20:50              # local time in the past year\n");
+	ErrPrint("  @1365808850                  # seconds since the epoch\n");
 	ErrPrint("\n");
 
 	ErrPrint("Contexts:\n");
@@ -1214,6 +2859,87 @@ static void ShowUsage(void)
 }
 
 
+/**
+ * @brief DoCmdHelp
+ *
+ * Usage: help
+ */
+static Result DoCmdHelp(int argc, char *argv[])
+{
+	ShowUsage();
+	return RESULT_HELP;
+}
+
+
+typedef struct
+{
+	const char *name;
+	Result    (*doCmd)(int argc, char *argv[]);
+}
+Command_t;
+
+
+static const Command_t kCommands[] =
+{
+	{ "def",    DoCmdDef    },
+	{ "log",    DoCmdLog    },
+	{ "logkv",  DoCmdLogKV  },
+	{ "klog",   DoCmdKLog   },
+	{ "reconf", DoCmdReConf },
+	{ "set",    DoCmdSet    },
+	{ "show",   DoCmdShow   },
+	{ "watch",  DoCmdWatch  },
+	{ "view",   DoCmdView   },
+	{ "flush",  DoCmdFlush  },
+	{ "flood",  DoCmdFlood  },
+	{ "shell",  DoCmdShell  },
+	{ "serve",  DoCmdServe  },
+#ifdef PMLOGCTL_BENCH
+	{ "bench",  DoCmdBench  },
+#endif
+	{ "help",   DoCmdHelp   },
+	{ "-help",  DoCmdHelp   },
+	{ NULL,     NULL        }
+};
+
+
+/**
+ * @brief DoCommand
+ *
+ * Run the command named by argv[ 0 ].
+ */
+Result DoCommand(int argc, char *argv[])
+{
+	const Command_t    *commandP;
+	Result              result;
+
+	for (commandP = kCommands; commandP->name != NULL; commandP++)
+	{
+		if (strcmp(argv[ 0 ], commandP->name) == 0)
+		{
+			break;
+		}
+	}
+
+	if (commandP->name != NULL)
+	{
+		result = commandP->doCmd(argc, argv);
+	}
+	else
+	{
+		ErrPrint("Invalid command '%s'\n", argv[ 0 ]);
+		result = RESULT_PARAM_ERR;
+	}
+
+	if (result == RESULT_PARAM_ERR)
+	{
+		SuggestHelp();
+	}
+
+	return result;
+}
+
+
 /**
  * @brief main
  */
@@ -1229,6 +2955,7 @@ int main(int argc, char *argv[])
 		if (argc < 2)
 		{
 			ErrPrint("No command specified.\n");
+			SuggestHelp();
 			result = RESULT_PARAM_ERR;
 			break;
 		}
@@ -1241,13 +2968,13 @@ int main(int argc, char *argv[])
 
 			if (argv[2])   // parameter next "-s" option
 			{
-				cmd = argv[2];
 				cmd_index = &argv[2];
 				modified_argc = argc - 2;
 			}
 			else
 			{
 				ErrPrint("No command specified.\n");
+				SuggestHelp();
 				result = RESULT_PARAM_ERR;
 				break;
 			}
@@ -1258,60 +2985,9 @@ int main(int argc, char *argv[])
 			modified_argc = argc - 1;
 		}
 
-		if (strcmp(cmd, "def") == 0)
-		{
-			result = DoCmdDef(modified_argc, cmd_index);
-		}
-		else if (strcmp(cmd, "log") == 0)
-		{
-			result = DoCmdLog(modified_argc, cmd_index);
-		}
-		else if (strcmp(cmd, "logkv") == 0)
-		{
-			result = DoCmdLogKV(modified_argc, cmd_index);
-		}
-		else if (strcmp(cmd, "klog") == 0)
-		{
-			result = DoCmdKLog(modified_argc, cmd_index);
-		}
-		else if (strcmp(cmd, "reconf") == 0)
-		{
-			result = DoCmdReConf(modified_argc, cmd_index);
-		}
-		else if (strcmp(cmd, "set") == 0)
-		{
-			result = DoCmdSet(modified_argc, cmd_index);
-		}
-		else if (strcmp(cmd, "show") == 0)
-		{
-			result = DoCmdShow(modified_argc, cmd_index);
-		}
-		else if (strcmp(cmd, "view") == 0)
-		{
-			result = DoCmdView(modified_argc, cmd_index);
-		}
-		else if (strcmp(cmd, "flush") == 0)
-		{
-			result = DoCmdFlush();
-		}
-		else if ((strcmp(cmd, "help") == 0) ||
-		         (strcmp(cmd, "-help") == 0))
-		{
-			ShowUsage();
-			result = RESULT_HELP;
-		}
-		else
-		{
-			ErrPrint("Invalid command '%s'\n", cmd);
-			result = RESULT_PARAM_ERR;
-		}
+		result = DoCommand(modified_argc, cmd_index);
 	}
 	while (false);
 
-	if (result == RESULT_PARAM_ERR)
-	{
-		SuggestHelp();
-	}
-
 	exit((result == RESULT_OK) ? EXIT_SUCCESS : EXIT_FAILURE);
 }
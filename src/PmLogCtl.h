@@ -33,6 +33,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <sys/time.h>
 
 /* Debugging/Error reporting utilities */
 
@@ -161,10 +162,36 @@ const char *GetFacilityStr(int fac);
 const char *GetLevelStr(int level);
 
 
+/**
+ * @brief DoCommand
+ *
+ * Run the command named by argv[ 0 ], as given on the command line.
+ */
+Result DoCommand(int argc, char *argv[]);
+
+
 /**
  * @brief PmLogView.c
  */
 Result DoCmdView(int argc, char *argv[]);
+Result CountViewMessages(const struct timeval *sinceTvP, const char *text,
+                         unsigned long *countP);
+#ifdef PMLOGCTL_BENCH
+Result DoCmdBench(int argc, char *argv[]);
+#endif
+
+
+/**
+ * @brief PmLogShell.c
+ */
+Result DoCmdShell(int argc, char *argv[]);
+Result DoCmdServe(int argc, char *argv[]);
+
+
+/**
+ * @brief PmLogFlood.c
+ */
+Result DoCmdFlood(int argc, char *argv[]);
 
 
 #endif /* PMLOGCTL_H */
@@ -0,0 +1,765 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ **********************************************************************
+ * @file PmLogFlood.c
+ *
+ * @brief Send many messages through PmLogLib, to measure the cost of
+ * logging and whether the daemon keeps up.
+ *
+ **********************************************************************
+ */
+
+
+#include "PmLogCtl.h"
+#include "PmLogLib.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/* arbitrary maximums */
+#define PMLOGFLOOD_MAX_THREADS      64
+#define PMLOGFLOOD_MAX_CONTEXTS     32
+#define PMLOGFLOOD_MAX_LEVELS       8
+
+/*
+ * The latency histogram has 16 buckets for each power of 2 nsecs, so
+ * the percentiles are within about 6%.
+ */
+#define PMLOGFLOOD_SUB_BUCKET_BITS  4
+#define PMLOGFLOOD_SUB_BUCKETS      (1 << PMLOGFLOOD_SUB_BUCKET_BITS)
+#define PMLOGFLOOD_LATENCY_BUCKETS  \
+	((64 - PMLOGFLOOD_SUB_BUCKET_BITS + 1) * PMLOGFLOOD_SUB_BUCKETS)
+
+
+typedef enum
+{
+	FLOOD_API_PRINT,
+	FLOOD_API_STRING,
+	FLOOD_API_BOTH
+}
+FloodApi_t;
+
+
+/**
+ * FloodConfig_t
+ *
+ * What to send.  The messages go round the contexts and levels in turn.
+ */
+typedef struct
+{
+	unsigned long   count;
+	double          rate;
+	int             numThreads;
+	FloodApi_t      api;
+	int             settleMsecs;
+	bool            check;
+
+	PmLogContext    contexts[ PMLOGFLOOD_MAX_CONTEXTS ];
+	int             numContexts;
+	int             levels[ PMLOGFLOOD_MAX_LEVELS ];
+	int             numLevels;
+
+	/* in every message, to find them again in the logs */
+	char            tag[ 64 ];
+}
+FloodConfig_t;
+
+
+/**
+ * FloodThread_t
+ *
+ * One sending thread, and what it measured.
+ */
+typedef struct
+{
+	const FloodConfig_t    *configP;
+	int                     index;
+	pthread_t               thread;
+
+	unsigned long           first;
+	unsigned long           count;
+
+	unsigned long           errors;
+	uint64_t                minNsecs;
+	uint64_t                maxNsecs;
+	uint64_t                totalNsecs;
+	uint64_t                latencies[ PMLOGFLOOD_LATENCY_BUCKETS ];
+}
+FloodThread_t;
+
+
+/**
+ * @brief PrvMonotonicNsecs
+ */
+static uint64_t PrvMonotonicNsecs(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+
+/**
+ * @brief PrvLatencyBucket
+ *
+ * The histogram bucket for the given number of nsecs.
+ */
+static int PrvLatencyBucket(uint64_t nsecs)
+{
+	int     shift;
+
+	if (nsecs < PMLOGFLOOD_SUB_BUCKETS)
+	{
+		return (int) nsecs;
+	}
+
+	shift = 0;
+
+	while ((nsecs >> shift) >= 2 * PMLOGFLOOD_SUB_BUCKETS)
+	{
+		shift++;
+	}
+
+	return (shift + 1) * PMLOGFLOOD_SUB_BUCKETS +
+	       (int)((nsecs >> shift) - PMLOGFLOOD_SUB_BUCKETS);
+}
+
+
+/**
+ * @brief PrvLatencyBucketNsecs
+ *
+ * The middle of the range of nsecs in the given histogram bucket.
+ */
+static double PrvLatencyBucketNsecs(int bucket)
+{
+	int     shift;
+	double  low;
+
+	if (bucket < 2 * PMLOGFLOOD_SUB_BUCKETS)
+	{
+		return bucket;
+	}
+
+	shift = bucket / PMLOGFLOOD_SUB_BUCKETS - 1;
+	low = (double)((uint64_t)(PMLOGFLOOD_SUB_BUCKETS +
+	                          bucket % PMLOGFLOOD_SUB_BUCKETS) << shift);
+
+	return low + (double)((uint64_t) 1 << shift) / 2;
+}
+
+
+/**
+ * @brief PrvFloodSend
+ *
+ * Send message number seq.
+ * @return the PmLogLib result.
+ */
+static PmLogErr PrvFloodSend(const FloodConfig_t *configP, int threadIndex,
+                             unsigned long seq)
+{
+	PmLogContext    context;
+	int             level;
+	bool            useString;
+	char            kv[ 64 ];
+
+	context = configP->contexts[ seq % configP->numContexts ];
+	level = configP->levels[ (seq / configP->numContexts) %
+	                         configP->numLevels ];
+
+	useString = (configP->api == FLOOD_API_STRING) ||
+	            ((configP->api == FLOOD_API_BOTH) && ((seq & 1) != 0));
+
+	if (!useString)
+	{
+		return PmLogPrint_(context, level, "%s %d %lu flood message",
+		                   configP->tag, threadIndex, seq);
+	}
+
+	/* debug messages can't have a msgID or key/values */
+	if (level == kPmLogLevel_Debug)
+	{
+		return PmLogString(context, level, NULL, NULL, configP->tag);
+	}
+
+	mysprintf(kv, sizeof(kv), "{\"THREAD\":%d,\"SEQ\":%lu}", threadIndex,
+	          seq);
+
+	return PmLogString(context, level, "PMLOGFLOOD", kv, configP->tag);
+}
+
+
+/**
+ * @brief PrvFloodThread
+ *
+ * Send this thread's share of the messages, at its share of the rate.
+ */
+static void *PrvFloodThread(void *arg)
+{
+	FloodThread_t          *threadP = (FloodThread_t *) arg;
+	const FloodConfig_t    *configP = threadP->configP;
+	uint64_t                intervalNsecs;
+	uint64_t                startNsecs;
+	uint64_t                beforeNsecs;
+	uint64_t                nsecs;
+	uint64_t                dueNsecs;
+	struct timespec         dueTs;
+	unsigned long           i;
+	PmLogErr                logErr;
+
+	intervalNsecs = 0;
+
+	if (configP->rate > 0)
+	{
+		intervalNsecs = (uint64_t)(1e9 * configP->numThreads /
+		                           configP->rate);
+	}
+
+	threadP->minNsecs = UINT64_MAX;
+	startNsecs = PrvMonotonicNsecs();
+
+	for (i = 0; i < threadP->count; i++)
+	{
+		if (intervalNsecs != 0)
+		{
+			/* keep to the schedule, not to the time of the last one */
+			dueNsecs = startNsecs + i * intervalNsecs;
+			dueTs.tv_sec = (time_t)(dueNsecs / 1000000000);
+			dueTs.tv_nsec = (long)(dueNsecs % 1000000000);
+
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &dueTs,
+			                       NULL) == EINTR)
+			{
+			}
+		}
+
+		beforeNsecs = PrvMonotonicNsecs();
+		logErr = PrvFloodSend(configP, threadP->index, threadP->first + i);
+		nsecs = PrvMonotonicNsecs() - beforeNsecs;
+
+		if (logErr != kPmLogErr_None)
+		{
+			threadP->errors++;
+		}
+
+		threadP->latencies[ PrvLatencyBucket(nsecs) ]++;
+		threadP->totalNsecs += nsecs;
+
+		if (nsecs < threadP->minNsecs)
+		{
+			threadP->minNsecs = nsecs;
+		}
+
+		if (nsecs > threadP->maxNsecs)
+		{
+			threadP->maxNsecs = nsecs;
+		}
+	}
+
+	return NULL;
+}
+
+
+/**
+ * @brief PrvPrintLatencies
+ *
+ * Show the percentiles of the merged latency histogram, in usecs.
+ */
+static void PrvPrintLatencies(const uint64_t *latencies, uint64_t total,
+                              uint64_t minNsecs, uint64_t maxNsecs,
+                              uint64_t sumNsecs)
+{
+	static const double kPercentiles[] = { 50, 90, 99, 99.9 };
+
+	size_t      iPct;
+	int         bucket;
+	uint64_t    n;
+	uint64_t    need;
+
+	printf("latency usec:  min %.2f  avg %.2f", minNsecs / 1e3,
+	       sumNsecs / 1e3 / total);
+
+	bucket = 0;
+	n = 0;
+
+	for (iPct = 0; iPct < sizeof(kPercentiles) / sizeof(kPercentiles[ 0 ]);
+	        iPct++)
+	{
+		need = (uint64_t)(kPercentiles[ iPct ] / 100 * total);
+
+		if (need == 0)
+		{
+			need = 1;
+		}
+
+		while ((n < need) && (bucket < PMLOGFLOOD_LATENCY_BUCKETS))
+		{
+			n += latencies[ bucket++ ];
+		}
+
+		printf("  p%g %.2f", kPercentiles[ iPct ],
+		       PrvLatencyBucketNsecs(bucket - 1) / 1e3);
+	}
+
+	printf("  max %.2f\n", maxNsecs / 1e3);
+}
+
+
+/**
+ * @brief PrvParseFloodContexts
+ *
+ * Look up the comma separated context names.
+ * @return false if one is not valid.
+ */
+static bool PrvParseFloodContexts(FloodConfig_t *configP, const char *list)
+{
+	char        name[ PMLOG_MAX_CONTEXT_NAME_LEN + 1 ];
+	const char *end;
+	size_t      len;
+	PmLogErr    logErr;
+
+	configP->numContexts = 0;
+
+	while (*list != 0)
+	{
+		end = strchr(list, ',');
+		len = (end != NULL) ? (size_t)(end - list) : strlen(list);
+
+		if ((len == 0) || (len >= sizeof(name)) ||
+		        (configP->numContexts >= PMLOGFLOOD_MAX_CONTEXTS))
+		{
+			return false;
+		}
+
+		memcpy(name, list, len);
+		name[ len ] = 0;
+
+		logErr = PmLogFindContext(name,
+		                          &configP->contexts[ configP->numContexts ]);
+
+		if (logErr != kPmLogErr_None)
+		{
+			return false;
+		}
+
+		configP->numContexts++;
+
+		list += len;
+
+		if (*list == ',')
+		{
+			list++;
+		}
+	}
+
+	return (configP->numContexts > 0);
+}
+
+
+/**
+ * @brief PrvParseFloodLevels
+ *
+ * Parse the comma separated level names.
+ * @return false if one is not valid.
+ */
+static bool PrvParseFloodLevels(FloodConfig_t *configP, const char *list)
+{
+	char        name[ 32 ];
+	const char *end;
+	size_t      len;
+	const int  *levelIntP;
+
+	configP->numLevels = 0;
+
+	while (*list != 0)
+	{
+		end = strchr(list, ',');
+		len = (end != NULL) ? (size_t)(end - list) : strlen(list);
+
+		if ((len == 0) || (len >= sizeof(name)) ||
+		        (configP->numLevels >= PMLOGFLOOD_MAX_LEVELS))
+		{
+			return false;
+		}
+
+		memcpy(name, list, len);
+		name[ len ] = 0;
+
+		levelIntP = PmLogStringToLevel(name);
+
+		if ((levelIntP == NULL) || (*levelIntP == -1))
+		{
+			ErrPrint("Invalid level '%s'.\n", name);
+			return false;
+		}
+
+		configP->levels[ configP->numLevels++ ] = *levelIntP;
+
+		list += len;
+
+		if (*list == ',')
+		{
+			list++;
+		}
+	}
+
+	return (configP->numLevels > 0);
+}
+
+
+/**
+ * @brief PrvParseFloodNumber
+ *
+ * @return false if s is not a number from min to max.
+ */
+static bool PrvParseFloodNumber(const char *s, double min, double max,
+                                double *nP)
+{
+	char   *end;
+
+	errno = 0;
+	*nP = strtod(s, &end);
+
+	return (s[ 0 ] != 0) && (*end == 0) && (errno == 0) &&
+	       (*nP >= min) && (*nP <= max);
+}
+
+
+/**
+ * @brief DoCmdFlood
+ *
+ * Usage: flood [--count <n>] [--rate <msgs/sec>] [--threads <n>]
+ *              [--context <contexts>] [--level <levels>]
+ *              [--api print|string|both] [--settle <msec>] [--no-check]
+ *
+ * Send <n> messages (default 10000) as fast as possible, or at the
+ * given total rate, from the given number of threads.  The messages go
+ * round the given contexts (default the global context) and levels
+ * (default info), and are sent with PmLogPrint, PmLogString, or each in
+ * turn.  Then the throughput and the per call latencies are shown.
+ * Unless --no-check is given, after waiting <msec> (default 1000) for
+ * the daemon to write them, the messages are looked for in the log
+ * files to count the ones that were dropped.  Messages below their
+ * context's level are not logged, so they count as dropped too.
+ */
+Result DoCmdFlood(int argc, char *argv[])
+{
+	FloodConfig_t      *configP;
+	FloodThread_t      *threads;
+	int                 i;
+	const char         *arg;
+	double              n;
+	unsigned long       perThread;
+	unsigned long       first;
+	int                 iThread;
+	int                 numStarted;
+	struct timeval      startTv;
+	uint64_t            startNsecs;
+	double              secs;
+	uint64_t           *latencies;
+	unsigned long       errors;
+	uint64_t            minNsecs;
+	uint64_t            maxNsecs;
+	uint64_t            sumNsecs;
+	unsigned long       sent;
+	unsigned long       found;
+	int                 bucket;
+	Result              result;
+
+	configP = (FloodConfig_t *) calloc(1, sizeof(*configP));
+
+	if (configP == NULL)
+	{
+		ErrPrint("Out of memory.\n");
+		return RESULT_RUN_ERR;
+	}
+
+	configP->count = 10000;
+	configP->numThreads = 1;
+	configP->api = FLOOD_API_PRINT;
+	configP->settleMsecs = 1000;
+	configP->check = true;
+	configP->contexts[ 0 ] = kPmLogGlobalContext;
+	configP->numContexts = 1;
+	configP->levels[ 0 ] = kPmLogLevel_Info;
+	configP->numLevels = 1;
+
+	result = RESULT_OK;
+	i = 1;
+
+	while ((i < argc) && (result == RESULT_OK))
+	{
+		arg = argv[ i++ ];
+
+		if (strcmp(arg, "--no-check") == 0)
+		{
+			configP->check = false;
+			continue;
+		}
+
+		if ((strcmp(arg, "--count") != 0) && (strcmp(arg, "--rate") != 0) &&
+		        (strcmp(arg, "--threads") != 0) &&
+		        (strcmp(arg, "--context") != 0) &&
+		        (strcmp(arg, "--level") != 0) && (strcmp(arg, "--api") != 0) &&
+		        (strcmp(arg, "--settle") != 0))
+		{
+			ErrPrint("Invalid parameter '%s'.\n", arg);
+			result = RESULT_PARAM_ERR;
+		}
+		else if (i >= argc)
+		{
+			ErrPrint("Invalid parameter: %s requires value\n", arg);
+			result = RESULT_PARAM_ERR;
+		}
+		else if (strcmp(arg, "--context") == 0)
+		{
+			if (!PrvParseFloodContexts(configP, argv[ i++ ]))
+			{
+				ErrPrint("Invalid contexts '%s'.\n", argv[ i - 1 ]);
+				result = RESULT_PARAM_ERR;
+			}
+		}
+		else if (strcmp(arg, "--level") == 0)
+		{
+			if (!PrvParseFloodLevels(configP, argv[ i++ ]))
+			{
+				ErrPrint("Invalid levels '%s'.\n", argv[ i - 1 ]);
+				result = RESULT_PARAM_ERR;
+			}
+		}
+		else if (strcmp(arg, "--api") == 0)
+		{
+			arg = argv[ i++ ];
+
+			if (strcmp(arg, "print") == 0)
+			{
+				configP->api = FLOOD_API_PRINT;
+			}
+			else if (strcmp(arg, "string") == 0)
+			{
+				configP->api = FLOOD_API_STRING;
+			}
+			else if (strcmp(arg, "both") == 0)
+			{
+				configP->api = FLOOD_API_BOTH;
+			}
+			else
+			{
+				ErrPrint("Invalid api '%s'.\n", arg);
+				result = RESULT_PARAM_ERR;
+			}
+		}
+		else if (strcmp(arg, "--count") == 0)
+		{
+			/* (double) ULONG_MAX rounds up past ULONG_MAX */
+			if (!PrvParseFloodNumber(argv[ i++ ], 1, ULONG_MAX, &n) ||
+			        (n >= (double) ULONG_MAX) || (n != (unsigned long) n))
+			{
+				ErrPrint("Invalid count '%s'.\n", argv[ i - 1 ]);
+				result = RESULT_PARAM_ERR;
+			}
+			else
+			{
+				configP->count = (unsigned long) n;
+			}
+		}
+		else if (strcmp(arg, "--rate") == 0)
+		{
+			if (!PrvParseFloodNumber(argv[ i++ ], 0, 1e9, &n) || (n <= 0))
+			{
+				ErrPrint("Invalid rate '%s'.\n", argv[ i - 1 ]);
+				result = RESULT_PARAM_ERR;
+			}
+
+			configP->rate = n;
+		}
+		else if (strcmp(arg, "--threads") == 0)
+		{
+			if (!PrvParseFloodNumber(argv[ i++ ], 1, PMLOGFLOOD_MAX_THREADS,
+			                         &n) || (n != (int) n))
+			{
+				ErrPrint("Invalid threads '%s'.\n", argv[ i - 1 ]);
+				result = RESULT_PARAM_ERR;
+			}
+			else
+			{
+				configP->numThreads = (int) n;
+			}
+		}
+		else
+		{
+			/* the wait is made in useconds_t microseconds */
+			if (!PrvParseFloodNumber(argv[ i++ ], 0, INT_MAX, &n) ||
+			        (n > (double)((useconds_t) -1) / 1000) ||
+			        (n != (int) n))
+			{
+				ErrPrint("Invalid settle time '%s'.\n", argv[ i - 1 ]);
+				result = RESULT_PARAM_ERR;
+			}
+			else
+			{
+				configP->settleMsecs = (int) n;
+			}
+		}
+	}
+
+	if (result != RESULT_OK)
+	{
+		free(configP);
+		return result;
+	}
+
+	if ((unsigned long) configP->numThreads > configP->count)
+	{
+		configP->numThreads = (int) configP->count;
+	}
+
+	threads = (FloodThread_t *) calloc((size_t) configP->numThreads,
+	                                   sizeof(threads[ 0 ]));
+
+	if (threads == NULL)
+	{
+		ErrPrint("Out of memory.\n");
+		free(configP);
+		return RESULT_RUN_ERR;
+	}
+
+	/* a tag that no other run will have used */
+	(void) gettimeofday(&startTv, NULL);
+	mysprintf(configP->tag, sizeof(configP->tag), "PMLOGFLOOD-%d-%ld.%06ld",
+	          (int) getpid(), (long) startTv.tv_sec, (long) startTv.tv_usec);
+
+	perThread = configP->count / configP->numThreads;
+	first = 0;
+
+	for (iThread = 0; iThread < configP->numThreads; iThread++)
+	{
+		threads[ iThread ].configP = configP;
+		threads[ iThread ].index = iThread;
+		threads[ iThread ].first = first;
+		threads[ iThread ].count = perThread +
+		                           ((iThread < (int)(configP->count %
+		                                   configP->numThreads)) ? 1 : 0);
+		first += threads[ iThread ].count;
+	}
+
+	startNsecs = PrvMonotonicNsecs();
+	numStarted = 0;
+
+	for (iThread = 0; iThread < configP->numThreads; iThread++)
+	{
+		if (pthread_create(&threads[ iThread ].thread, NULL, PrvFloodThread,
+		                   &threads[ iThread ]) != 0)
+		{
+			ErrPrint("Error starting thread.\n");
+			result = RESULT_RUN_ERR;
+			break;
+		}
+
+		numStarted++;
+	}
+
+	for (iThread = 0; iThread < numStarted; iThread++)
+	{
+		(void) pthread_join(threads[ iThread ].thread, NULL);
+	}
+
+	secs = (PrvMonotonicNsecs() - startNsecs) / 1e9;
+
+	latencies = (uint64_t *) calloc(PMLOGFLOOD_LATENCY_BUCKETS,
+	                                sizeof(latencies[ 0 ]));
+
+	if (latencies == NULL)
+	{
+		ErrPrint("Out of memory.\n");
+		free(threads);
+		free(configP);
+		return RESULT_RUN_ERR;
+	}
+
+	sent = 0;
+	errors = 0;
+	minNsecs = UINT64_MAX;
+	maxNsecs = 0;
+	sumNsecs = 0;
+
+	for (iThread = 0; iThread < numStarted; iThread++)
+	{
+		sent += threads[ iThread ].count;
+		errors += threads[ iThread ].errors;
+		sumNsecs += threads[ iThread ].totalNsecs;
+
+		if (threads[ iThread ].minNsecs < minNsecs)
+		{
+			minNsecs = threads[ iThread ].minNsecs;
+		}
+
+		if (threads[ iThread ].maxNsecs > maxNsecs)
+		{
+			maxNsecs = threads[ iThread ].maxNsecs;
+		}
+
+		for (bucket = 0; bucket < PMLOGFLOOD_LATENCY_BUCKETS; bucket++)
+		{
+			latencies[ bucket ] += threads[ iThread ].latencies[ bucket ];
+		}
+	}
+
+	if (sent > 0)
+	{
+		printf("sent:          %lu in %.3f sec (%.0f msgs/sec), %lu errors\n",
+		       sent, secs, (secs > 0) ? sent / secs : 0.0, errors);
+
+		PrvPrintLatencies(latencies, sent, minNsecs, maxNsecs, sumNsecs);
+	}
+
+	if ((result == RESULT_OK) && configP->check)
+	{
+		(void) fflush(stdout);
+		(void) usleep((useconds_t) configP->settleMsecs * (useconds_t) 1000);
+
+		/* the logs may only have whole seconds */
+		startTv.tv_sec--;
+
+		result = CountViewMessages(&startTv, configP->tag, &found);
+
+		if (result == RESULT_OK)
+		{
+			printf("logged:        %lu, %lu dropped\n", found,
+			       (found < sent - errors) ? sent - errors - found : 0);
+		}
+	}
+
+	free(latencies);
+	free(threads);
+	free(configP);
+
+	return result;
+}
@@ -0,0 +1,504 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2007-2013 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+
+/**
+ **********************************************************************
+ * @file PmLogShell.c
+ *
+ * @brief Run many commands in one process, read from stdin or from
+ * clients of a Unix socket.
+ *
+ **********************************************************************
+ */
+
+
+/* for struct ucred */
+#define _GNU_SOURCE
+
+#include "PmLogCtl.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+/* arbitrary maximum */
+#define PMLOGSHELL_MAX_ARGS     256
+
+
+/**
+ * @brief PrvSplitCommandLine
+ *
+ * Split the line in place into words, like a shell would: words are
+ * separated by white space, and may be quoted with "" or '', and
+ * outside '' a '\' quotes the next char.
+ * @return false if the line can't be split.
+ */
+static bool PrvSplitCommandLine(char *line, char *argv[], int maxArgs,
+                                int *argcP)
+{
+	char   *s;
+	char   *d;
+	char    quote;
+	int     argc;
+
+	argc = 0;
+	s = line;
+
+	for (;;)
+	{
+		while ((*s == ' ') || (*s == '\t') || (*s == '\n') || (*s == '\r'))
+		{
+			s++;
+		}
+
+		if (*s == 0)
+		{
+			break;
+		}
+
+		if (argc >= maxArgs - 1)
+		{
+			ErrPrint("Too many parameters.\n");
+			return false;
+		}
+
+		/* unquote the word onto itself, it can only get shorter */
+		argv[ argc++ ] = s;
+		d = s;
+		quote = 0;
+
+		while (*s != 0)
+		{
+			if (quote == 0)
+			{
+				if ((*s == ' ') || (*s == '\t') || (*s == '\n') ||
+				        (*s == '\r'))
+				{
+					break;
+				}
+
+				if ((*s == '"') || (*s == '\''))
+				{
+					quote = *s++;
+					continue;
+				}
+			}
+			else if (*s == quote)
+			{
+				quote = 0;
+				s++;
+				continue;
+			}
+
+			if ((*s == '\\') && (quote != '\'') && (s[ 1 ] != 0))
+			{
+				s++;
+			}
+
+			*d++ = *s++;
+		}
+
+		if (quote != 0)
+		{
+			ErrPrint("Unterminated quote.\n");
+			return false;
+		}
+
+		if (*s != 0)
+		{
+			s++;
+		}
+
+		*d = 0;
+	}
+
+	argv[ argc ] = NULL;
+	*argcP = argc;
+
+	return true;
+}
+
+
+/**
+ * @brief PrvRefusedCommand
+ *
+ * Commands that would not return, or would run another shell, are not
+ * run from a shell: while serving, they would hold up all the other
+ * clients.  Nor are the ones that read stdin, as that is the shell's
+ * own input, or the server's.
+ * @return the form of the command that can't be run from a shell, or
+ * NULL if it can be.
+ */
+static const char *PrvRefusedCommand(int argc, char *argv[])
+{
+	int     i;
+
+	if ((strcmp(argv[ 0 ], "shell") == 0) ||
+	        (strcmp(argv[ 0 ], "serve") == 0) ||
+	        (strcmp(argv[ 0 ], "watch") == 0))
+	{
+		return argv[ 0 ];
+	}
+
+	for (i = 1; i < argc; i++)
+	{
+		if ((strcmp(argv[ 0 ], "view") == 0) &&
+		        (strcmp(argv[ i ], "--follow") == 0))
+		{
+			return "view --follow";
+		}
+
+		if ((strcmp(argv[ 0 ], "klog") == 0) &&
+		        (strcmp(argv[ i ], "-") == 0))
+		{
+			return "klog -";
+		}
+
+		if ((strcmp(argv[ 0 ], "set") == 0) &&
+		        (strcmp(argv[ i ], "-f") == 0) && (i + 1 < argc) &&
+		        (strcmp(argv[ i + 1 ], "-") == 0))
+		{
+			return "set -f -";
+		}
+	}
+
+	return NULL;
+}
+
+
+/**
+ * @brief PrvRunCommandLine
+ *
+ * Run the command on the line, if it has one.
+ * @return false if it is the command to stop.
+ */
+static bool PrvRunCommandLine(char *line, bool *haveResultP, Result *resultP)
+{
+	char       *argv[ PMLOGSHELL_MAX_ARGS ];
+	int         argc;
+	const char *refused;
+
+	*haveResultP = false;
+
+	if (!PrvSplitCommandLine(line, argv, PMLOGSHELL_MAX_ARGS, &argc))
+	{
+		*haveResultP = true;
+		*resultP = RESULT_PARAM_ERR;
+		return true;
+	}
+
+	if ((argc == 0) || (argv[ 0 ][ 0 ] == '#'))
+	{
+		return true;
+	}
+
+	if ((strcmp(argv[ 0 ], "quit") == 0) || (strcmp(argv[ 0 ], "exit") == 0))
+	{
+		return false;
+	}
+
+	*haveResultP = true;
+
+	refused = PrvRefusedCommand(argc, argv);
+
+	if (refused != NULL)
+	{
+		ErrPrint("'%s' can't be run from shell or serve.\n", refused);
+		*resultP = RESULT_PARAM_ERR;
+		return true;
+	}
+
+	*resultP = DoCommand(argc, argv);
+
+	/* whatever the command wrote should be seen now */
+	(void) fflush(stdout);
+
+	return true;
+}
+
+
+/**
+ * @brief DoCmdShell
+ *
+ * Usage: shell
+ *
+ * Run commands read from stdin, one per line, until end of file or
+ * "quit".  PmLogLib stays attached and the context list is kept between
+ * commands, so this is much cheaper than running them one at a time.
+ * Commands that don't return (watch, view --follow), the ones that
+ * read stdin (klog -, set -f -) and shell and serve themselves are
+ * refused.
+ * @return the result of the last command that failed, or RESULT_OK.
+ */
+Result DoCmdShell(int argc, char *argv[])
+{
+	char       *line;
+	size_t      lineSize;
+	bool        interactive;
+	bool        haveResult;
+	Result      result;
+	Result      shellResult;
+
+	if (argc >= 2)
+	{
+		ErrPrint("Invalid parameter '%s'.\n", argv[ 1 ]);
+		return RESULT_PARAM_ERR;
+	}
+
+	shellResult = RESULT_OK;
+	interactive = isatty(STDIN_FILENO);
+	line = NULL;
+	lineSize = 0;
+
+	for (;;)
+	{
+		if (interactive)
+		{
+			fprintf(stdout, "PmLogCtl> ");
+			(void) fflush(stdout);
+		}
+
+		if (getline(&line, &lineSize, stdin) < 0)
+		{
+			break;
+		}
+
+		if (!PrvRunCommandLine(line, &haveResult, &result))
+		{
+			break;
+		}
+
+		if (haveResult && (result != RESULT_OK) && (result != RESULT_HELP))
+		{
+			shellResult = result;
+		}
+	}
+
+	free(line);
+
+	return shellResult;
+}
+
+
+/**
+ * @brief PrvServeClient
+ *
+ * Run the client's commands until it disconnects or sends "quit".
+ * While a command runs its output goes to the client, and after it,
+ * a line of "OK" or "ERROR".
+ */
+static void PrvServeClient(int clientFd)
+{
+	FILE       *f;
+	char       *line;
+	size_t      lineSize;
+	int         savedOutFd;
+	int         savedErrFd;
+	bool        haveResult;
+	Result      result;
+	const char *status;
+	ssize_t     n;
+	int         err;
+
+	f = fdopen(dup(clientFd), "r");
+
+	if (f == NULL)
+	{
+		err = errno;
+		ErrPrint("Error reading client: %s\n", strerror(err));
+		return;
+	}
+
+	(void) fflush(stdout);
+	(void) fflush(stderr);
+
+	savedOutFd = dup(STDOUT_FILENO);
+	savedErrFd = dup(STDERR_FILENO);
+
+	(void) dup2(clientFd, STDOUT_FILENO);
+	(void) dup2(clientFd, STDERR_FILENO);
+
+	line = NULL;
+	lineSize = 0;
+
+	while (getline(&line, &lineSize, f) >= 0)
+	{
+		if (!PrvRunCommandLine(line, &haveResult, &result))
+		{
+			break;
+		}
+
+		if (!haveResult)
+		{
+			continue;
+		}
+
+		(void) fflush(stderr);
+
+		status = ((result == RESULT_OK) || (result == RESULT_HELP)) ?
+		         "OK\n" : "ERROR\n";
+
+		do
+		{
+			n = write(clientFd, status, strlen(status));
+		}
+		while ((n < 0) && (errno == EINTR));
+
+		if (n < 0)
+		{
+			break;
+		}
+	}
+
+	free(line);
+	(void) fclose(f);
+
+	(void) fflush(stdout);
+	(void) fflush(stderr);
+
+	(void) dup2(savedOutFd, STDOUT_FILENO);
+	(void) dup2(savedErrFd, STDERR_FILENO);
+	(void) close(savedOutFd);
+	(void) close(savedErrFd);
+}
+
+
+/**
+ * @brief DoCmdServe
+ *
+ * Usage: serve <socket path>
+ *
+ * Like shell, but the commands come from clients that connect to a
+ * Unix stream socket at the given path.  Clients are served one at a
+ * time, in the order they connect.  The socket is only accessible to
+ * the server's user, and clients running as another user are turned
+ * away.
+ */
+Result DoCmdServe(int argc, char *argv[])
+{
+	const char         *path;
+	struct sockaddr_un  addr;
+	struct stat         statBuf;
+	struct ucred        cred;
+	socklen_t           credLen;
+	mode_t              savedMask;
+	int                 listenFd;
+	int                 clientFd;
+	int                 bindErr;
+	int                 err;
+
+	if (argc < 2)
+	{
+		ErrPrint("Socket path not specified.\n");
+		return RESULT_PARAM_ERR;
+	}
+
+	if (argc >= 3)
+	{
+		ErrPrint("Invalid parameter '%s'.\n", argv[ 2 ]);
+		return RESULT_PARAM_ERR;
+	}
+
+	path = argv[ 1 ];
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		ErrPrint("Socket path '%s' is too long.\n", path);
+		return RESULT_PARAM_ERR;
+	}
+
+	/* replace a socket left from an earlier run, but nothing else */
+	if ((lstat(path, &statBuf) == 0) && S_ISSOCK(statBuf.st_mode))
+	{
+		(void) unlink(path);
+	}
+
+	listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (listenFd < 0)
+	{
+		err = errno;
+		ErrPrint("Error creating socket: %s\n", strerror(err));
+		return RESULT_RUN_ERR;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	mystrcpy(addr.sun_path, sizeof(addr.sun_path), path);
+
+	/* so that the socket is never accessible to others */
+	savedMask = umask(0177);
+	bindErr = bind(listenFd, (struct sockaddr *) &addr, sizeof(addr));
+	(void) umask(savedMask);
+
+	if ((bindErr < 0) || (chmod(path, 0600) < 0) ||
+	        (listen(listenFd, 8) < 0))
+	{
+		err = errno;
+		ErrPrint("Error listening on '%s': %s\n", path, strerror(err));
+		(void) close(listenFd);
+		return RESULT_RUN_ERR;
+	}
+
+	/* a client going away shouldn't stop the server */
+	(void) signal(SIGPIPE, SIG_IGN);
+
+	for (;;)
+	{
+		clientFd = accept(listenFd, NULL, NULL);
+
+		if (clientFd < 0)
+		{
+			err = errno;
+
+			if ((err == EINTR) || (err == ECONNABORTED))
+			{
+				continue;
+			}
+
+			ErrPrint("Error accepting on '%s': %s\n", path, strerror(err));
+			break;
+		}
+
+		credLen = sizeof(cred);
+
+		if ((getsockopt(clientFd, SOL_SOCKET, SO_PEERCRED, &cred,
+		                &credLen) < 0) || (cred.uid != geteuid()))
+		{
+			ErrPrint("Rejected client not running as this user.\n");
+			(void) close(clientFd);
+			continue;
+		}
+
+		PrvServeClient(clientFd);
+		(void) close(clientFd);
+	}
+
+	(void) close(listenFd);
+	(void) unlink(path);
+
+	return RESULT_RUN_ERR;
+}